@@ -1,7 +1,7 @@
 # allows to add DEPLOYMENTFOLDERS and links to the Felgo library and QtCreator auto-completion
 CONFIG += felgo
 
-QT += multimedia-private
+QT += multimedia-private network
 
 # Project identifier and version
 # More information: https://felgo.com/doc/felgo-publishing/#project-configuration
@@ -20,6 +20,8 @@ RESOURCES += resources.qrc
 SOURCES += main.cpp \
     cartoonifier.cpp \
     cnfilter.cpp \
+    cningest.cpp \
+    cnstreamserver.cpp \
     cnvideo.cpp
 # Uncomment this if you choose to use the pre-complied OpenCV binaries provided with this tutorial
 # INCLUDEPATH += C:/opencv/build/include
@@ -88,4 +90,6 @@ macx {
 HEADERS += \
     cartoonifier.h \
     cnfilter.h \
+    cningest.h \
+    cnstreamserver.h \
     cnvideo.h
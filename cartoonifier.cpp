@@ -6,19 +6,112 @@ Cartoonifier::Cartoonifier(QObject *parent) : QObject(parent)
 }
 
 QImage Cartoonifier::cartoonify(QImage inputImage, Mode mode)
+{
+    return cartoonify(fromQImageToMat(inputImage), mode);
+}
+
+QImage Cartoonifier::cartoonify(const Mat &inputFrame, Mode mode)
 {    
-    Mat inputFrame, outputFrame;
-    inputFrame = fromQImageToMat(inputImage);
+    Mat smallImg, coefficientA, coefficientB, gray;
+
+    if(mode != Sketch)
+        prepareSmoothing(inputFrame, smallImg, coefficientA, coefficientB);
+
+    Mat outputFrame = renderRows(inputFrame, 0, inputFrame.size(), smallImg, coefficientA, coefficientB, mode, gray);
+
+    if(mode == Sketch)
+        return fromMatToQImage(outputFrame, QImage::Format_Grayscale8);
+
+    if(mode == AlienCartoon){
+
+        //detect face
+        vector<cv::Rect> detected = detectFace(gray);
+
+        //qDebug() << "detected: " << detected.size();
+
+        if(detected.size() > 0){
+
+            loadAlienMask();
+
+            if(alienImage.data){
+
+                Mat resizedAlienMask;
+                Mat resizedAlienImage;
+                Mat faceROI;
+
+                outputFrame.convertTo(outputFrame,CV_8UC4);
+
+                for(size_t i=0; i<detected.size(); i++){
+                    faceROI = outputFrame(detected[i]);
+                    resize(alienImage, resizedAlienImage, Size(faceROI.cols, faceROI.rows));
+                    resize(alienMask, resizedAlienMask, Size(faceROI.cols, faceROI.rows));
+                    resizedAlienImage.copyTo(faceROI,resizedAlienMask);
+                }
 
+            }
+
+        }
+
+    }
+
+    return fromMatToQImage(outputFrame);
+
+}
+
+QImage Cartoonifier::cartoonifyTiled(const Mat &inputFrame, Mode mode, int maxTilePixels)
+{
+    int width = inputFrame.cols;
+    int height = inputFrame.rows;
+
+    // The faces have to be detected on the whole frame, so the alien mode is never split.
+    if(mode == AlienCartoon || width * height <= maxTilePixels)
+        return cartoonify(inputFrame, mode);
+
+    // The smoothing runs once, on the whole shrunken image, which is small. Only the full resolution stages (edge
+    // mask, upsampling and masked copy) run in horizontal strips. Each strip is extended above and below by the
+    // reach of the edge mask filters (see tileOverlap()) and only its inner rows are kept. The upsampling maps
+    // the rows of a strip the same way as on the whole image (see upsampleRows()), so it needs no overlap.
+    Mat smallImg, coefficientA, coefficientB, gray;
+
+    if(mode != Sketch)
+        prepareSmoothing(inputFrame, smallImg, coefficientA, coefficientB);
+
+    const int TILE_OVERLAP = tileOverlap();
+    int stripHeight = std::max(1, (maxTilePixels / width) - (2 * TILE_OVERLAP));
+
+    QImage outputImage(width, height, mode == Sketch ? QImage::Format_Grayscale8 : QImage::Format_RGB888);
+
+    for(int y=0; y<height; y+=stripHeight){
+
+        int top = std::max(0, y - TILE_OVERLAP);
+        int bottom = std::min(height, y + stripHeight + TILE_OVERLAP);
+        int rows = std::min(stripHeight, height - y);
+
+        Mat tile = renderRows(inputFrame.rowRange(top, bottom), top, inputFrame.size(),
+                              smallImg, coefficientA, coefficientB, mode, gray);
+
+        size_t rowBytes = width * tile.elemSize();
+
+        for(int row=0; row<rows; row++){
+            memcpy(outputImage.scanLine(y + row), tile.ptr(y - top + row), rowBytes);
+        }
+    }
+
+    return outputImage;
+}
+
+Mat Cartoonifier::renderRows(const Mat &inputRows, int top, Size size, const Mat &smallImg,
+                             const Mat &coefficientA, const Mat &coefficientB, Mode mode, Mat &gray)
+{
     // Since Laplacian filters use grayscale images, we must convert from OpenCV's
     // default BGR format to Grayscale.
-    Mat gray;
-    cvtColor(inputFrame, gray, COLOR_BGR2GRAY);
+    // The unfiltered luma is kept as the guide for the guided upsampling.
+    Mat luma;
+    cvtColor(inputRows, luma, COLOR_BGR2GRAY);
 
     // We will use a Median filter because it is good at removing noise while keeping edges sharp; also, it is not as
     // slow as a bilateral filter.
-    const int MEDIAN_BLUR_FILTER_SIZE = 7;
-    medianBlur(gray, gray, MEDIAN_BLUR_FILTER_SIZE);
+    medianBlur(luma, gray, MEDIAN_BLUR_FILTER_SIZE);
 
     Mat mask, edges, edges2;
 
@@ -28,8 +121,8 @@ QImage Cartoonifier::cartoonify(QImage inputImage, Mode mode)
         // Scharr gradient filter along x and y (the second image in the figure), and then apply a binary threshold with a very low
         // cutoff (the third image in the figure) and a 3 x 3 Median blur, producing the final "evil" mask
 
-        Scharr(inputFrame, edges, CV_8U, 1, 0);
-        Scharr(inputFrame, edges2, CV_8U, 1, 0, -1);
+        Scharr(inputRows, edges, CV_8U, 1, 0);
+        Scharr(inputRows, edges2, CV_8U, 1, 0, -1);
         edges += edges2; // Combine the x & y edges together.
         const int EVIL_EDGE_THRESHOLD = 12;
         threshold(edges, mask, EVIL_EDGE_THRESHOLD, 255, THRESH_BINARY_INV);
@@ -39,7 +132,6 @@ QImage Cartoonifier::cartoonify(QImage inputImage, Mode mode)
 
     }else {
 
-        const int LAPLACIAN_FILTER_SIZE = 5;
         Laplacian(gray, edges, CV_8U, LAPLACIAN_FILTER_SIZE);
 
         // The Laplacian filter produces edges with varying brightness, so to make the edges look more like a
@@ -50,22 +142,66 @@ QImage Cartoonifier::cartoonify(QImage inputImage, Mode mode)
         removePepperNoise(mask);
 
         if(mode == Sketch)
-            return fromMatToQImage(mask, QImage::Format_Grayscale8);
+            return mask;
 
     }
 
+    // Remember that the smoothing was applied to the shrunken image, so we need to expand the image back to the
+    // original size. A plain resize blurs the color boundaries, more so the smaller the image was; the guided
+    // upsampling uses the full resolution luma to put them back where they belong.
+    Mat bigImg;
+
+    if(guidedUpsampling){
+
+        Mat rowsA, rowsB, lumaF, luma3;
+        upsampleRows(coefficientA, size, top, inputRows.rows, rowsA);
+        upsampleRows(coefficientB, size, top, inputRows.rows, rowsB);
+
+        luma.convertTo(lumaF, CV_32F, 1.0/255);
+        cvtColor(lumaF, luma3, COLOR_GRAY2BGR);
+
+        Mat q = rowsA.mul(luma3) + rowsB;
+        q.convertTo(bigImg, CV_8UC3, 255);
+
+    }else {
+        upsampleRows(smallImg, size, top, inputRows.rows, bigImg);
+    }
+
+    if(mode == Painting)
+        return bigImg;
+
+    // Then we can overlay the edge mask that we found earlier. To overlay the edge mask
+    // "sketch" onto the bilateral filter "painting" (left-hand side of the following figure), we can start with a
+    // black background and copy the "painting" pixels that aren't edges in the "sketch" mask
+    Mat outputFrame = Mat::zeros(bigImg.size(), bigImg.type());
+    bigImg.copyTo(outputFrame, mask);
+
+    return outputFrame;
+}
+
+void Cartoonifier::prepareSmoothing(const Mat &inputFrame, Mat &smallImg, Mat &coefficientA, Mat &coefficientB)
+{
     // A strong bilateral filter smoothes flat regions while keeping edges sharp, and is therefore great as an
     // automatic cartoonifier or painting filter, except that it is extremely slow (that is, measured in seconds or
     // even minutes rather than milliseconds!). We will therefore use some tricks to obtain a nice cartoonifier
     // that still runs at an acceptable speed. The most important trick we can use is to perform bilateral
     // filtering at a lower resolution. It will have a similar effect as at full resolution, but will run much faster.
-    // Let's reduce the total number of pixels by a factor of four (for example, half width and half height):
+    // Let's reduce the total number of pixels by a factor of four (for example, half width and half height), or
+    // more when a larger smoothing scale is set:
     Size size = inputFrame.size();
     Size smallSize;
-    smallSize.width = size.width/2;
-    smallSize.height = size.height/2;
-    Mat smallImg = Mat(smallSize, CV_8UC3);
-    resize(inputFrame, smallImg, smallSize, 0,0, INTER_LINEAR);
+    smallSize.width = std::max(1, size.width/smoothingScale);
+    smallSize.height = std::max(1, size.height/smoothingScale);
+    smallImg = Mat(smallSize, CV_8UC3);
+    // Past half size, INTER_LINEAR would skip pixels and alias, so the pixels are averaged instead.
+    resize(inputFrame, smallImg, smallSize, 0,0, smoothingScale > 2 ? INTER_AREA : INTER_LINEAR);
+
+    // The guide of the guided upsampling at the low resolution. The shrinking averages the pixels and the luma is
+    // a weighted sum of the channels, so this is the shrunken luma.
+    Mat smallGuide;
+
+    if(guidedUpsampling)
+        cvtColor(smallImg, smallGuide, COLOR_BGR2GRAY);
 
     // Rather than applying a large bilateral filter, we will apply many small bilateral filters to produce a
     // strong cartoon effect in less time.
@@ -75,64 +211,58 @@ QImage Cartoonifier::cartoonify(QImage inputImage, Mode mode)
     // "in-place processing"), but we can apply one filter storing a temp Mat and another filter storing back to
     // the input:
     Mat tmp = Mat(smallSize, CV_8UC3);
-    int repetitions = 7; // Repetitions for strong cartoon effect.
+    int repetitions = BILATERAL_REPETITIONS; // Repetitions for strong cartoon effect.
 
     for (int i=0; i<repetitions; i++) {
-        int ksize = 9; // Filter size. Has a large effect on speed.
+        int ksize = BILATERAL_FILTER_SIZE; // Filter size. Has a large effect on speed.
         double sigmaColor = 9; // Filter color strength.
         double sigmaSpace = 7; // Spatial strength. Affects speed.
         bilateralFilter(smallImg, tmp, ksize, sigmaColor, sigmaSpace);
         bilateralFilter(tmp, smallImg, ksize, sigmaColor, sigmaSpace);
     }
 
-    // Remember that this was applied to the shrunken image, so we need to expand the image back to the
-    // original size.
-    Mat bigImg;
-    resize(smallImg, bigImg, size, 0,0, INTER_LINEAR);
-
-    if(mode == Painting)
-        return fromMatToQImage(bigImg);
-
-    // Then we can overlay the edge mask that we found earlier. To overlay the edge mask
-    // "sketch" onto the bilateral filter "painting" (left-hand side of the following figure), we can start with a
-    // black background and copy the "painting" pixels that aren't edges in the "sketch" mask
-    outputFrame.setTo(0);
-    bigImg.copyTo(outputFrame, mask);
-
-    if(mode == AlienCartoon){
-
-        //detect face
-        vector<cv::Rect> detected = detectFace(gray);
-
-        //qDebug() << "detected: " << detected.size();
-
-        if(detected.size() > 0){
+    if(guidedUpsampling)
+        guidedCoefficients(smallImg, smallGuide, coefficientA, coefficientB);
+}
 
-            loadAlienMask();
+void Cartoonifier::upsampleRows(const Mat &smallImg, Size size, int top, int rows, Mat &output)
+{
+    if(top == 0 && rows == size.height){
+        resize(smallImg, output, size, 0,0, INTER_LINEAR);
+        return;
+    }
 
-            if(alienImage.data){
+    // The same mapping as resize() on the whole image: the centre of a full resolution pixel x maps to
+    // (x + 0.5) * small / size - 0.5. Only the shrunken rows the strip needs, plus one on each side for the
+    // interpolation, are used.
+    double fx = (double)smallImg.cols / size.width;
+    double fy = (double)smallImg.rows / size.height;
 
-                Mat resizedAlienMask;
-                Mat resizedAlienImage;
-                Mat faceROI;
+    int smallTop = std::max(0, (int)std::floor((top + 0.5) * fy - 0.5) - 1);
+    int smallBottom = std::min(smallImg.rows, (int)std::ceil((top + rows - 0.5) * fy - 0.5) + 2);
 
-                outputFrame.convertTo(outputFrame,CV_8UC4);
+    Mat transform = (Mat_<double>(2, 3) << fx, 0, 0.5 * fx - 0.5,
+                                           0, fy, (top + 0.5) * fy - 0.5 - smallTop);
 
-                for(size_t i=0; i<detected.size(); i++){
-                    faceROI = outputFrame(detected[i]);
-                    resize(alienImage, resizedAlienImage, Size(faceROI.cols, faceROI.rows));
-                    resize(alienMask, resizedAlienMask, Size(faceROI.cols, faceROI.rows));
-                    resizedAlienImage.copyTo(faceROI,resizedAlienMask);
-                }
-
-            }
-
-        }
+    warpAffine(smallImg.rowRange(smallTop, smallBottom), output, transform, Size(size.width, rows),
+               INTER_LINEAR | WARP_INVERSE_MAP, BORDER_REPLICATE);
+}
 
-    }
+int Cartoonifier::tileOverlap() const
+{
+    // The median blur, then the Laplacian and the 5 x 5 pepper noise removal, each one reaching a few more rows
+    // (the scary mode's Scharr and 3 x 3 median reach less).
+    return MEDIAN_BLUR_FILTER_SIZE/2 + LAPLACIAN_FILTER_SIZE/2 + 2;
+}
 
-    return fromMatToQImage(outputFrame);
+void Cartoonifier::setSmoothingScale(int scale)
+{
+    smoothingScale = std::max(1, scale);
+}
 
+void Cartoonifier::setGuidedUpsampling(bool enabled)
+{
+    guidedUpsampling = enabled;
 }
 
 void Cartoonifier::loadCascadeClassifier()
@@ -301,6 +431,44 @@ void Cartoonifier::removePepperNoise(Mat &mask)
     }
 }
 
+void Cartoonifier::guidedCoefficients(const Mat &smallImg, const Mat &smallGuide, Mat &a, Mat &b)
+{
+    // Fast guided filter (He & Sun): every color channel is modelled locally as a linear function of the luma,
+    // q = a * I + b. The coefficients are fitted here at the low resolution, where the smoothing happened, and since
+    // they vary slowly they are upsampled like the color and then applied to the full resolution luma (see
+    // renderRows()).
+    const double GUIDED_EPS = 0.001; // Regularization, in [0,1] intensity units. Smaller keeps more edges.
+    Size boxSize(2*GUIDED_RADIUS + 1, 2*GUIDED_RADIUS + 1);
+
+    Mat I, p;
+    smallGuide.convertTo(I, CV_32F, 1.0/255);
+    smallImg.convertTo(p, CV_32FC3, 1.0/255);
+
+    Mat meanI, meanII, varI;
+    boxFilter(I, meanI, -1, boxSize);
+    boxFilter(I.mul(I), meanII, -1, boxSize);
+    // The difference can come out slightly negative in float, and the regularization has to be added before the
+    // variance is replicated: adding a double to a 3 channel Mat only adds it to the first channel.
+    varI = meanII - meanI.mul(meanI);
+    varI = cv::max(varI, 0.0) + GUIDED_EPS;
+
+    // The guide is single channel, so it is replicated to match the color channels.
+    Mat I3, meanI3, varI3;
+    cvtColor(I, I3, COLOR_GRAY2BGR);
+    cvtColor(meanI, meanI3, COLOR_GRAY2BGR);
+    cvtColor(varI, varI3, COLOR_GRAY2BGR);
+
+    Mat meanP, meanIP;
+    boxFilter(p, meanP, -1, boxSize);
+    boxFilter(I3.mul(p), meanIP, -1, boxSize);
+
+    divide(meanIP - meanI3.mul(meanP), varI3, a);
+    b = meanP - a.mul(meanI3);
+
+    boxFilter(a, a, -1, boxSize);
+    boxFilter(b, b, -1, boxSize);
+}
+
 Mat Cartoonifier::fromQImageToMat(QImage image)
 {
     image = image.convertToFormat(QImage::Format_RGB888);
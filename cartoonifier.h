@@ -30,6 +30,11 @@ public:
     explicit Cartoonifier(QObject *parent = nullptr);
 
     QImage cartoonify(QImage inputImage, Mode mode);
+    QImage cartoonify(const Mat &inputFrame, Mode mode);
+    QImage cartoonifyTiled(const Mat &inputFrame, Mode mode, int maxTilePixels);
+
+    void setSmoothingScale(int scale);
+    void setGuidedUpsampling(bool enabled);
 
 signals:
 
@@ -40,11 +45,28 @@ private:
     vector<Mat> alienImageLayers;
     Mat alienMask;
 
+    // The bilateral smoothing runs at 1/smoothingScale of the input resolution. Guided upsampling restores
+    // the color edges from the full resolution luma, which makes 1/4 and 1/8 usable.
+    int smoothingScale = 2;
+    bool guidedUpsampling = false;
+
+    const int MEDIAN_BLUR_FILTER_SIZE = 7;
+    const int LAPLACIAN_FILTER_SIZE = 5;
+    const int BILATERAL_FILTER_SIZE = 9;
+    const int BILATERAL_REPETITIONS = 7;
+    const int GUIDED_RADIUS = 1;
+
     void loadCascadeClassifier();
     void loadAlienMask();
 
     vector<cv::Rect> detectFace(Mat mat);
 
+    void prepareSmoothing(const Mat &inputFrame, Mat &smallImg, Mat &coefficientA, Mat &coefficientB);
+    void guidedCoefficients(const Mat &smallImg, const Mat &smallGuide, Mat &a, Mat &b);
+    Mat renderRows(const Mat &inputRows, int top, Size size, const Mat &smallImg,
+                   const Mat &coefficientA, const Mat &coefficientB, Mode mode, Mat &gray);
+    void upsampleRows(const Mat &smallImg, Size size, int top, int rows, Mat &output);
+    int tileOverlap() const;
     void removePepperNoise(Mat &mask);
     cv::Mat fromQImageToMat(QImage image);
     QImage fromMatToQImage(Mat mat, QImage::Format format = QImage::Format_RGB888);
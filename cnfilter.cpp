@@ -3,7 +3,20 @@
 CNFilter::CNFilter(QObject *parent) : QAbstractVideoFilter(parent)
 {    
     workerThreads.resize(WORKER_THREAD_COUNT);
+    ingestBuffers.resize(WORKER_THREAD_COUNT);
     cartoonifier = new Cartoonifier(this);
+
+    captureThreadPool.setMaxThreadCount(1);
+    captureCartoonifier = new Cartoonifier(this);
+
+    captureTimeoutTimer = new QTimer(this);
+    captureTimeoutTimer->setSingleShot(true);
+    captureTimeoutTimer->setInterval(CAPTURE_TIMEOUT);
+    connect(captureTimeoutTimer, &QTimer::timeout, this, &CNFilter::onCaptureTimeout);
+
+    streamServer = new CNStreamServer(this);
+    connect(this, &CNFilter::imageEncoded, streamServer, &CNStreamServer::publishFrame);
+    connect(streamServer, &CNStreamServer::clientCountChanged, this, &CNFilter::streamClientCountChanged);
 }
 
 CNFilter::~CNFilter()
@@ -25,6 +38,8 @@ CNFilter::~CNFilter()
         counter++;
     }
 
+    captureThreadPool.waitForDone();
+
 }
 
 QVideoFilterRunnable *CNFilter::createFilterRunnable()
@@ -39,6 +54,122 @@ void CNFilter::registerQMLType()
     qmlRegisterType<Cartoonifier>("Cartoonifier", 1, 0, "Cartoonifier");
 }
 
+int CNFilter::smoothingScale() const
+{
+    return m_smoothingScale;
+}
+
+void CNFilter::setSmoothingScale(int scale)
+{
+    if(scale < 1 || scale == m_smoothingScale){
+        return;
+    }
+
+    m_smoothingScale = scale;
+    cartoonifier->setSmoothingScale(scale);
+    captureCartoonifier->setSmoothingScale(scale);
+
+    emit smoothingScaleChanged();
+}
+
+bool CNFilter::guidedUpsampling() const
+{
+    return m_guidedUpsampling;
+}
+
+void CNFilter::setGuidedUpsampling(bool enabled)
+{
+    if(enabled == m_guidedUpsampling){
+        return;
+    }
+
+    m_guidedUpsampling = enabled;
+    cartoonifier->setGuidedUpsampling(enabled);
+    captureCartoonifier->setGuidedUpsampling(enabled);
+
+    emit guidedUpsamplingChanged();
+}
+
+QString CNFilter::encoderFormat() const
+{
+    QMutexLocker locker(&encoderFormatMutex);
+    return m_encoderFormat;
+}
+
+void CNFilter::setEncoderFormat(const QString &format)
+{
+    if(!QImageWriter::supportedImageFormats().contains(format.toLower().toLatin1())){
+        qWarning() << "-- unsupported encoder format:" << format;
+        return;
+    }
+
+    {
+        QMutexLocker locker(&encoderFormatMutex);
+
+        if(format == m_encoderFormat){
+            return;
+        }
+
+        m_encoderFormat = format;
+    }
+
+    emit encoderFormatChanged();
+}
+
+int CNFilter::streamPort() const
+{
+    return m_streamPort;
+}
+
+void CNFilter::setStreamPort(int port)
+{
+    if(port == m_streamPort){
+        return;
+    }
+
+    //a port of 0 disables the stream
+    if(port > 0){
+
+        if(!streamServer->listen(static_cast<quint16>(port))){
+            port = 0;
+        }
+
+    }else {
+        streamServer->close();
+    }
+
+    if(port == m_streamPort){
+        return;
+    }
+
+    m_streamPort = port;
+    emit streamPortChanged();
+}
+
+int CNFilter::streamClientCount() const
+{
+    return streamServer->clientCount();
+}
+
+void CNFilter::capture()
+{
+    if(!captureState.testAndSetOrdered(CaptureIdle, CaptureRequested)){
+        qWarning() << "-- a capture is already in progress...";
+        return;
+    }
+
+    captureTimeoutTimer->start();
+}
+
+void CNFilter::onCaptureTimeout()
+{
+    //only a request that no frame has taken yet is dropped, a running capture always finishes
+    if(captureState.testAndSetOrdered(CaptureRequested, CaptureIdle)){
+        qWarning() << "-- no frame arrived for the capture...";
+        emit captureFinished("", 0);
+    }
+}
+
 QImage CNFilter::videoFrameToImage(QVideoFrame *frame)
 {
     if(frame->handleType() == QAbstractVideoBuffer::NoHandle){
@@ -50,15 +181,13 @@ QImage CNFilter::videoFrameToImage(QVideoFrame *frame)
             return QImage();
         }
 
-        if(image.format() != QImage::Format_RGB32){
-            image = image.convertToFormat(QImage::Format_RGB32);
-        }
-
+        //any format conversion is left to CNIngest, which does it while downscaling
         return image;
     }
 
     if(frame->handleType() == QAbstractVideoBuffer::GLTextureHandle){
-        QImage image(frame->width(), frame->height(), QImage::Format_RGB32);
+        //glReadPixels writes R, G, B, A bytes, which CNIngest reads as they are
+        QImage image(frame->width(), frame->height(), QImage::Format_RGBX8888);
         GLuint textureId = frame->handle().toUInt();//static_cast<GLuint>(frame.handle().toInt());
         QOpenGLContext *ctx = QOpenGLContext::currentContext();
         QOpenGLFunctions *f = ctx->functions();
@@ -70,13 +199,67 @@ QImage CNFilter::videoFrameToImage(QVideoFrame *frame)
         f->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureId, 0);
         f->glReadPixels(0, 0, frame->width(), frame->height(), GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
         f->glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(prevFbo));
-        return image.rgbSwapped();
+        return image;
     }
 
     qDebug() << "-- Invalid image format...";
     return QImage();
 }
 
+void CNFilter::processCapture(QImage image, int rotation, Cartoonifier::Mode mode)
+{
+    //the live preview has priority over the capture. On Linux and Android the normal threads are SCHED_OTHER, where
+    //the lower QThread priorities are ignored, only IdlePriority (SCHED_IDLE) is honoured. The capture lane thread
+    //only ever runs captures, so it is left at that priority
+    QThread::currentThread()->setPriority(QThread::IdlePriority);
+
+    //OpenCV would otherwise spread the filters of the capture over all the cores, at normal priority, through
+    //its own thread pool. The setting is global, so the preview workers run their filters on a single thread
+    //too while a capture runs, they already use a core each
+    int openCVThreads = cv::getNumThreads();
+    cv::setNumThreads(1);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    //upright, at native resolution
+    Mat frame;
+    CNIngest::ingest(image, rotation, 0, frame);
+    image = QImage();
+
+    //large frames are processed in strips to bound the memory used by the filters
+    if(!frame.empty()){
+        image = captureCartoonifier->cartoonifyTiled(frame, mode, CAPTURE_MAX_TILE_PIXELS);
+    }
+
+    QString path;
+
+    if(!image.isNull()){
+
+        QString dirPath = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
+        QDir().mkpath(dirPath);
+
+        path = dirPath + "/cartoon_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss_zzz") + ".jpg";
+
+        QImageWriter writer(path, QByteArray("JPEG"));
+        writer.setQuality(95);
+
+        if(!writer.write(image)){
+            qWarning() << "-- could not save capture:" << writer.errorString();
+            path.clear();
+        }
+
+    }else {
+        qWarning() << "Invalid capture image....";
+    }
+
+    cv::setNumThreads(openCVThreads);
+
+    captureState.storeRelease(CaptureIdle);
+
+    emit captureFinished(path, static_cast<int>(timer.elapsed()));
+}
+
 CNFilterRunnable::CNFilterRunnable(CNFilter *filter) : QObject(nullptr), filter(filter)
 {
 
@@ -96,6 +279,26 @@ QVideoFrame CNFilterRunnable::run(QVideoFrame *input, const QVideoSurfaceFormat
         return QVideoFrame();
     }
 
+    CNFrameSettings settings;
+    settings.rotation = filter->m_orientation;
+    settings.encoderFormat = filter->encoderFormat().toLatin1();
+    settings.encoderQuality = filter->m_encoderQuality;
+    settings.streaming = filter->m_streamPort > 0;
+
+    //a requested capture takes the full resolution frame, regardless of how busy the preview workers are
+    QImage fullImage;
+
+    if(filter->captureState.testAndSetOrdered(CNFilter::CaptureRequested, CNFilter::CaptureRunning)){
+        fullImage = filter->videoFrameToImage(input);
+
+        if(fullImage.isNull()){
+            //try again with the next frame
+            filter->captureState.storeRelease(CNFilter::CaptureRequested);
+        }else {
+            QtConcurrent::run(&filter->captureThreadPool, filter, &CNFilter::processCapture, fullImage, settings.rotation, filter->m_mode);
+        }
+    }
+
     QVectorIterator<QFuture<void>> i(filter->workerThreads);
 
     QFuture<void> availableWorkerThread;
@@ -119,37 +322,44 @@ QVideoFrame CNFilterRunnable::run(QVideoFrame *input, const QVideoSurfaceFormat
         return * input;
     }    
 
-    QImage image = filter->videoFrameToImage(input);
-    filter->workerThreads[counter] = QtConcurrent::run(this, &CNFilterRunnable::preprocessImage, image);
+    //the frame is only read once, a frame taken for a capture is shared with the preview worker
+    QImage image = fullImage.isNull() ? filter->videoFrameToImage(input) : fullImage;
+    filter->workerThreads[counter] = QtConcurrent::run(this, &CNFilterRunnable::preprocessImage, image, counter, settings);
 
     return * input;
 }
 
-void CNFilterRunnable::preprocessImage(QImage image)
+void CNFilterRunnable::preprocessImage(QImage image, int slot, CNFrameSettings settings)
 {        
-    //if android, make image upright
-#ifdef Q_OS_ANDROID
-    QPoint center = image.rect().center();
-    QMatrix matrix;
-    matrix.translate(center.x(), center.y());
-    matrix.rotate(90);
-    image = image.transformed(matrix);
-#endif
-
-    double resizedWidth, resizedHeight;
+    //rotate upright, downscale and convert to the cartoonifier's format in one pass
+    Mat &frame = filter->ingestBuffers[slot];
+    CNIngest::ingest(image, settings.rotation, filter->PREVIEW_WIDTH, frame);
 
-    resizedWidth = 640;
-    resizedHeight = ((double)image.height()/(double)image.width()) * resizedWidth;
-    image = image.scaled(resizedWidth, resizedHeight, Qt::KeepAspectRatio);
+    if(frame.empty()){
+        qWarning() << "Invalid image....";
+        return;
+    }
 
-    image = filter->cartoonifier->cartoonify(image, filter->m_mode);
+    image = filter->cartoonifier->cartoonify(frame, filter->m_mode);
 
     if(!image.isNull()){
         QByteArray byteArray;
         QBuffer buffer(&byteArray);
-        QImageWriter writer(&buffer,QByteArray("JPEG"));
-        writer.setQuality(50);
-        writer.write(image);
+        QImageWriter writer(&buffer,settings.encoderFormat);
+        writer.setQuality(settings.encoderQuality);
+
+        QElapsedTimer encodeTimer;
+        encodeTimer.start();
+
+        if(!writer.write(image)){
+            qWarning() << "-- could not encode image:" << writer.errorString();
+            return;
+        }
+
+        //the frame is encoded only once, the stream clients share the same buffer
+        if(settings.streaming){
+            emit filter->imageEncoded(byteArray, settings.encoderFormat, encodeTimer.nsecsElapsed());
+        }
 
         QString data = QString::fromStdString(byteArray.toBase64().toStdString());
         emit filter->cartoonifiedImageDataReady(data);
@@ -9,13 +9,37 @@
 #include <QOpenGLFunctions>
 #include <QOpenGLContext>
 #include <QImageWriter>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QDir>
+#include <QMutex>
+#include <QTimer>
 
 #include <private/qvideoframe_p.h>
 #include <cartoonifier.h>
+#include <cnstreamserver.h>
+#include <cningest.h>
+
+//per frame settings, taken on the render thread and handed to the worker processing the frame
+struct CNFrameSettings {
+    int rotation = 0;
+    QByteArray encoderFormat;
+    int encoderQuality = 50;
+    bool streaming = false;
+};
 
 class CNFilter : public QAbstractVideoFilter {
     Q_OBJECT
     Q_PROPERTY(Cartoonifier::Mode mode MEMBER m_mode NOTIFY modeChanged)
+    Q_PROPERTY(int orientation MEMBER m_orientation NOTIFY orientationChanged)
+    Q_PROPERTY(int smoothingScale READ smoothingScale WRITE setSmoothingScale NOTIFY smoothingScaleChanged)
+    Q_PROPERTY(bool guidedUpsampling READ guidedUpsampling WRITE setGuidedUpsampling NOTIFY guidedUpsamplingChanged)
+    Q_PROPERTY(int encoderQuality MEMBER m_encoderQuality NOTIFY encoderQualityChanged)
+    Q_PROPERTY(QString encoderFormat READ encoderFormat WRITE setEncoderFormat NOTIFY encoderFormatChanged)
+    Q_PROPERTY(int streamPort READ streamPort WRITE setStreamPort NOTIFY streamPortChanged)
+    Q_PROPERTY(int streamClientCount READ streamClientCount NOTIFY streamClientCountChanged)
 friend class CNFilterRunnable;
 
 public:
@@ -26,19 +50,82 @@ public:
 
     void static registerQMLType();
 
+    int smoothingScale() const;
+    void setSmoothingScale(int scale);
+
+    bool guidedUpsampling() const;
+    void setGuidedUpsampling(bool enabled);
+
+    QString encoderFormat() const;
+    void setEncoderFormat(const QString &format);
+
+    int streamPort() const;
+    void setStreamPort(int port);
+
+    int streamClientCount() const;
+
+    //grabs the next camera frame at full resolution and cartoonifies it in the background,
+    //captureFinished() is emitted once it has been saved
+    Q_INVOKABLE void capture();
+
 signals:
     void cartoonifiedImageDataReady(QString data);
     void modeChanged();
+    void orientationChanged();
+    void smoothingScaleChanged();
+    void guidedUpsamplingChanged();
+    void encoderQualityChanged();
+    void encoderFormatChanged();
+    void streamPortChanged();
+    void streamClientCountChanged();
+    void captureFinished(QString path, int processingTime);
+
+    //emitted from the worker threads, delivered to the stream server through a queued connection
+    void imageEncoded(const QByteArray data, const QByteArray format, qint64 encodeTime);
 
 private:
     QVector<QFuture<void>> workerThreads;
     const int WORKER_THREAD_COUNT = 3;
+    const int PREVIEW_WIDTH = 640;
+    //one ingest buffer per worker thread, reused from frame to frame
+    QVector<Mat> ingestBuffers;
     Cartoonifier *cartoonifier;    
+    CNStreamServer *streamServer;
+
+    //captures get their own lane so that they don't compete with the live preview workers
+    //captureState is shared by the GUI, render and capture threads
+    enum CaptureState {
+        CaptureIdle = 0,
+        CaptureRequested = 1,
+        CaptureRunning = 2
+    };
+
+    QThreadPool captureThreadPool;
+    QAtomicInt captureState;
+    Cartoonifier *captureCartoonifier;
+    const int CAPTURE_MAX_TILE_PIXELS = 1920 * 1080;
+    //a request that no frame picked up in this time (the camera stopped, the frames can't be read) is dropped
+    QTimer *captureTimeoutTimer;
+    const int CAPTURE_TIMEOUT = 2000;
     bool isProcessing = false;
 
     Cartoonifier::Mode m_mode = Cartoonifier::Cartoon;
+    //clockwise rotation in degrees that makes the camera frames upright, see Main.qml for how it is derived
+    //from the camera's sensor orientation
+    int m_orientation = 0;
+    int m_smoothingScale = 2;
+    bool m_guidedUpsampling = false;
+    int m_encoderQuality = 50;
+    QString m_encoderFormat = "JPEG";
+    //guards m_encoderFormat, which is written from QML and read on the render thread
+    mutable QMutex encoderFormatMutex;
+    int m_streamPort = 0;
 
     QImage videoFrameToImage(QVideoFrame *frame);
+    void processCapture(QImage image, int rotation, Cartoonifier::Mode mode);
+
+private slots:
+    void onCaptureTimeout();
 };
 
 
@@ -53,7 +140,7 @@ public:
     virtual ~CNFilterRunnable();
 
     QVideoFrame run(QVideoFrame *input, const QVideoSurfaceFormat &surfaceFormat, RunFlags flags);   
-    void preprocessImage(QImage image);
+    void preprocessImage(QImage image, int slot, CNFrameSettings settings);
 
 private:
     CNFilter *filter;    
@@ -0,0 +1,142 @@
+#include "cningest.h"
+
+void CNIngest::ingest(const QImage &image, int rotation, int targetWidth, cv::Mat &output)
+{
+    QImage source = image;
+
+    bool rgbaByteOrder = false;
+
+    switch(source.format()){
+    case QImage::Format_RGBX8888:
+    case QImage::Format_RGBA8888:
+    case QImage::Format_RGBA8888_Premultiplied:
+        rgbaByteOrder = true;
+        break;
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        break;
+    default:
+        source = source.convertToFormat(QImage::Format_RGB32);
+        break;
+    }
+
+    // Byte offsets of the channels within a pixel. RGB32 and ARGB32 are 0xAARRGGBB words, so their byte order
+    // depends on the endianness, while the 8888 formats are always R, G, B, A in memory.
+    int redOffset, greenOffset, blueOffset;
+
+    if(rgbaByteOrder){
+        redOffset = 0;
+        greenOffset = 1;
+        blueOffset = 2;
+    }else {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        redOffset = 2;
+        greenOffset = 1;
+        blueOffset = 0;
+#else
+        redOffset = 1;
+        greenOffset = 2;
+        blueOffset = 3;
+#endif
+    }
+
+    if(source.isNull()){
+        output.release();
+        return;
+    }
+
+    rotation = ((rotation % 360) + 360) % 360;
+    rotation = (rotation / 90) * 90;
+
+    const int sourceWidth = source.width();
+    const int sourceHeight = source.height();
+    const qptrdiff bytesPerLine = source.bytesPerLine();
+
+    // size of the frame once upright
+    const bool transposed = (rotation == 90 || rotation == 270);
+    const int uprightWidth = transposed ? sourceHeight : sourceWidth;
+    const int uprightHeight = transposed ? sourceWidth : sourceHeight;
+
+    int outputWidth = uprightWidth;
+    int outputHeight = uprightHeight;
+
+    if(targetWidth > 0){
+        outputWidth = targetWidth;
+        outputHeight = std::max(1, (int)(((qint64)uprightHeight * targetWidth) / uprightWidth));
+    }
+
+    output.create(outputHeight, outputWidth, CV_8UC3);
+
+    // The offset of a source pixel is split into a term that only depends on the output column and one that only
+    // depends on the output row. For 90 and 270 degrees the output columns walk down the source rows, which is
+    // what makes the rotation a transpose.
+    std::vector<qptrdiff> columnOffsets(outputWidth);
+    std::vector<qptrdiff> rowOffsets(outputHeight);
+
+    for(int ox=0; ox<outputWidth; ox++){
+        int x = (int)(((qint64)ox * uprightWidth) / outputWidth);
+
+        switch(rotation){
+        case 90:
+            columnOffsets[ox] = (qptrdiff)(sourceHeight - 1 - x) * bytesPerLine;
+            break;
+        case 180:
+            columnOffsets[ox] = (qptrdiff)(sourceWidth - 1 - x) * 4;
+            break;
+        case 270:
+            columnOffsets[ox] = (qptrdiff)x * bytesPerLine;
+            break;
+        default:
+            columnOffsets[ox] = (qptrdiff)x * 4;
+            break;
+        }
+    }
+
+    for(int oy=0; oy<outputHeight; oy++){
+        int y = (int)(((qint64)oy * uprightHeight) / outputHeight);
+
+        switch(rotation){
+        case 90:
+            rowOffsets[oy] = (qptrdiff)y * 4;
+            break;
+        case 180:
+            rowOffsets[oy] = (qptrdiff)(sourceHeight - 1 - y) * bytesPerLine;
+            break;
+        case 270:
+            rowOffsets[oy] = (qptrdiff)(sourceWidth - 1 - y) * 4;
+            break;
+        default:
+            rowOffsets[oy] = (qptrdiff)y * bytesPerLine;
+            break;
+        }
+    }
+
+    const uchar *bits = source.constBits();
+
+    // Work in square blocks so that a rotated copy reads a few cache lines of many source rows at a time
+    // rather than a single pixel of every source row.
+    for(int blockY=0; blockY<outputHeight; blockY+=BLOCK_SIZE){
+
+        const int blockBottom = std::min(blockY + BLOCK_SIZE, outputHeight);
+
+        for(int blockX=0; blockX<outputWidth; blockX+=BLOCK_SIZE){
+
+            const int blockRight = std::min(blockX + BLOCK_SIZE, outputWidth);
+
+            for(int oy=blockY; oy<blockBottom; oy++){
+
+                const uchar *sourceLine = bits + rowOffsets[oy];
+                uchar *pOut = output.ptr<uchar>(oy) + blockX * 3;
+
+                for(int ox=blockX; ox<blockRight; ox++){
+                    const uchar *pixel = sourceLine + columnOffsets[ox];
+                    pOut[0] = pixel[redOffset];
+                    pOut[1] = pixel[greenOffset];
+                    pOut[2] = pixel[blueOffset];
+                    pOut += 3;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef CNINGEST_H
+#define CNINGEST_H
+
+#include <QImage>
+#include <QDebug>
+
+#include "opencv2/opencv.hpp"
+
+// Turns a camera frame into the working format of the Cartoonifier (8 bit, 3 channel RGB Mat) in a single pass.
+// The rotation to make the frame upright, the downscale and the color conversion (including the red/blue order
+// of the source) are all folded into one nearest neighbour copy, instead of a QImage transform, scale and format
+// conversion each producing a full intermediate image.
+class CNIngest
+{
+public:
+    // rotation is the clockwise rotation in degrees (0, 90, 180 or 270) that makes the frame upright.
+    // targetWidth is the width of the upright output, 0 keeps the native resolution.
+    // output is (re)allocated only when its size changes, so a buffer can be reused across frames.
+    // 32 bit frames are read as they are, in either the RGB32/ARGB32 or the RGBX8888/RGBA8888 (GL) byte order;
+    // other formats are converted first.
+    static void ingest(const QImage &image, int rotation, int targetWidth, cv::Mat &output);
+
+private:
+    static const int BLOCK_SIZE = 32;
+};
+
+#endif // CNINGEST_H
@@ -0,0 +1,238 @@
+#include "cnstreamserver.h"
+
+static const QByteArray BOUNDARY = QByteArrayLiteral("cnframe");
+static const QByteArray PART_TRAILER = QByteArrayLiteral("\r\n");
+static const int MAX_REQUEST_SIZE = 8192;
+//at most this much of a frame is queued in a socket at a time
+static const qint64 CHUNK_SIZE = 16384;
+static const int STATS_FRAME_COUNT = 100;
+
+CNStreamServer::CNStreamServer(QObject *parent) : QObject(parent)
+{
+    server = new QTcpServer(this);
+    connect(server, &QTcpServer::newConnection, this, &CNStreamServer::onNewConnection);
+}
+
+CNStreamServer::~CNStreamServer()
+{
+    close();
+}
+
+bool CNStreamServer::listen(quint16 port)
+{
+    if(server->isListening()){
+        close();
+    }
+
+    //only local clients are served
+    if(!server->listen(QHostAddress::LocalHost, port)){
+        qWarning() << "-- stream server could not listen on port" << port << ":" << server->errorString();
+        return false;
+    }
+
+    qDebug() << "-- streaming on http://127.0.0.1:" + QString::number(server->serverPort());
+    return true;
+}
+
+void CNStreamServer::close()
+{
+    server->close();
+
+    QList<QTcpSocket*> sockets = clients.keys();
+    clients.clear();
+
+    for(QTcpSocket *socket : sockets){
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+
+    if(!sockets.isEmpty()){
+        emit clientCountChanged();
+    }
+}
+
+int CNStreamServer::clientCount() const
+{
+    return clients.size();
+}
+
+void CNStreamServer::publishFrame(const QByteArray frame, const QByteArray format, qint64 encodeTime)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray partHeader;
+    partHeader.append("--" + BOUNDARY + "\r\n");
+    partHeader.append("Content-Type: image/" + format.toLower() + "\r\n");
+    partHeader.append("Content-Length: " + QByteArray::number(frame.size()) + "\r\n\r\n");
+
+    QHash<QTcpSocket*, Client>::iterator i;
+
+    for(i = clients.begin(); i != clients.end(); ++i){
+
+        if(!i.value().streaming){
+            continue;
+        }
+
+        //a client still busy with an older frame only remembers the newest one, replacing any frame it
+        //had not started yet. QByteArray is implicitly shared, so this is just a reference to the encoded frame
+        i.value().pendingPartHeader = partHeader;
+        i.value().pendingFrame = frame;
+
+        writeChunks(i.key(), i.value());
+    }
+
+    statsFanOutTime += timer.nsecsElapsed();
+    statsEncodeTime += encodeTime;
+
+    if(++statsFrames >= STATS_FRAME_COUNT){
+        logStats();
+    }
+}
+
+void CNStreamServer::onNewConnection()
+{
+    while(server->hasPendingConnections()){
+
+        QTcpSocket *socket = server->nextPendingConnection();
+
+        connect(socket, &QTcpSocket::readyRead, this, &CNStreamServer::onReadyRead);
+        connect(socket, &QTcpSocket::bytesWritten, this, &CNStreamServer::onBytesWritten);
+        connect(socket, &QTcpSocket::disconnected, this, &CNStreamServer::onDisconnected);
+
+        clients.insert(socket, Client());
+    }
+
+    emit clientCountChanged();
+}
+
+void CNStreamServer::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+
+    if(!socket || !clients.contains(socket)){
+        return;
+    }
+
+    Client &client = clients[socket];
+
+    if(client.streaming){
+        //nothing more is expected from the client
+        socket->readAll();
+        return;
+    }
+
+    client.request.append(socket->readAll());
+
+    if(!client.request.contains("\r\n\r\n")){
+
+        if(client.request.size() > MAX_REQUEST_SIZE){
+            socket->abort();
+        }
+
+        return;
+    }
+
+    //every request path gets the stream
+    client.request.clear();
+    client.streaming = true;
+
+    socket->write("HTTP/1.0 200 OK\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Pragma: no-cache\r\n"
+                  "Connection: close\r\n"
+                  "Content-Type: multipart/x-mixed-replace; boundary=" + BOUNDARY + "\r\n"
+                  "\r\n");
+}
+
+void CNStreamServer::onBytesWritten()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+
+    if(!socket || !clients.contains(socket)){
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    writeChunks(socket, clients[socket]);
+
+    statsFanOutTime += timer.nsecsElapsed();
+}
+
+void CNStreamServer::onDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+
+    if(!socket){
+        return;
+    }
+
+    if(clients.remove(socket) > 0){
+        emit clientCountChanged();
+    }
+
+    socket->deleteLater();
+}
+
+void CNStreamServer::logStats()
+{
+    qDebug() << "-- stream:" << clients.size() << "clients,"
+             << "encode" << (double)statsEncodeTime / statsFrames / 1000000.0 << "ms/frame,"
+             << "fan-out" << (double)statsFanOutTime / statsFrames / 1000000.0 << "ms/frame";
+
+    statsFrames = 0;
+    statsEncodeTime = 0;
+    statsFanOutTime = 0;
+}
+
+void CNStreamServer::writeChunks(QTcpSocket *socket, Client &client)
+{
+    if(!client.streaming){
+        return;
+    }
+
+    while(socket->bytesToWrite() < CHUNK_SIZE){
+
+        if(client.frame.isNull()){
+
+            if(client.pendingFrame.isNull()){
+                return;
+            }
+
+            client.partHeader = client.pendingPartHeader;
+            client.frame = client.pendingFrame;
+            client.offset = 0;
+            client.pendingPartHeader = QByteArray();
+            client.pendingFrame = QByteArray();
+        }
+
+        //find the segment of the part the offset is in
+        const QByteArray *segment;
+        qint64 segmentOffset = client.offset;
+
+        if(segmentOffset < client.partHeader.size()){
+            segment = &client.partHeader;
+        }else if((segmentOffset -= client.partHeader.size()) < client.frame.size()){
+            segment = &client.frame;
+        }else if((segmentOffset -= client.frame.size()) < PART_TRAILER.size()){
+            segment = &PART_TRAILER;
+        }else {
+            //the whole part has been queued
+            client.partHeader = QByteArray();
+            client.frame = QByteArray();
+            continue;
+        }
+
+        qint64 length = qMin(segment->size() - segmentOffset, CHUNK_SIZE);
+        qint64 written = socket->write(segment->constData() + segmentOffset, length);
+
+        if(written <= 0){
+            return;
+        }
+
+        client.offset += written;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef CNSTREAMSERVER_H
+#define CNSTREAMSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QDebug>
+
+// Serves the encoded result frames as an MJPEG (multipart/x-mixed-replace) stream over HTTP on localhost.
+// Every frame is encoded once by the filter and the same implicitly shared QByteArray is handed to all the
+// clients. Each client keeps a reference to the frame it is sending and an offset into it, and only a chunk at a
+// time is copied into its socket, so there is a single copy of a frame however many clients are connected.
+// A client that is still busy sending a frame only keeps a reference to the newest one, so slow clients skip
+// frames instead of buffering them.
+class CNStreamServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CNStreamServer(QObject *parent = nullptr);
+    virtual ~CNStreamServer();
+
+    bool listen(quint16 port);
+    void close();
+
+    int clientCount() const;
+
+public slots:
+    //encodeTime is the time it took to encode the frame, in nanoseconds, it is only used for the statistics
+    void publishFrame(const QByteArray frame, const QByteArray format, qint64 encodeTime);
+
+signals:
+    void clientCountChanged();
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onBytesWritten();
+    void onDisconnected();
+
+private:
+    //a multipart part is the part header, the frame and a line break. The header is built once per frame too
+    struct Client {
+        bool streaming = false;
+        QByteArray request;
+        QByteArray partHeader;
+        QByteArray frame;
+        qint64 offset = 0;
+        QByteArray pendingPartHeader;
+        QByteArray pendingFrame;
+    };
+
+    QTcpServer *server;
+    QHash<QTcpSocket*, Client> clients;
+
+    //encode and fan-out (queueing the frames to the sockets) times, logged every STATS_FRAME_COUNT frames
+    int statsFrames = 0;
+    qint64 statsEncodeTime = 0;
+    qint64 statsFanOutTime = 0;
+
+    void logStats();
+
+    void writeChunks(QTcpSocket *socket, Client &client);
+};
+
+#endif // CNSTREAMSERVER_H
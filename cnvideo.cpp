@@ -61,7 +61,8 @@ void CNVideo::updateImage(const QString data)
 
     image = QImage();
 
-    if(image.loadFromData(byteArray,"JPEG")){
+    //the format is detected from the data, see CNFilter::encoderFormat
+    if(image.loadFromData(byteArray)){
         //qDebug() << "Image loaded...";
     }else {
         qDebug() << "Error loading image...";
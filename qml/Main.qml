@@ -35,6 +35,19 @@ App {
 
     CNFilter{
         id: cnFilter
+        //the frames are rotated upright according to the camera sensor orientation. A front camera's sensor
+        //orientation is given for the mirrored image, so it is counted the other way around
+        orientation: camera.position === Camera.FrontFace ? (360 - camera.orientation) % 360 : camera.orientation
+        //set a port (e.g 8080) to also stream the result as MJPEG on http://127.0.0.1:<port>
+        streamPort: 0
+
+        onCaptureFinished: {
+            if(path !== ""){
+                console.log("capture saved to " + path + " in " + processingTime + "ms");
+            }else{
+                console.log("capture failed");
+            }
+        }
 
         onCartoonifiedImageDataReady: {
             cnVideo.updateImage(data);
@@ -103,6 +116,30 @@ App {
             }
         }
 
+        Rectangle{
+            width: 60
+            height: 60
+            anchors.horizontalCenter: parent.horizontalCenter
+            anchors.bottom: parent.bottom
+            anchors.bottomMargin: 95
+            radius: width/2
+
+            Rectangle{
+                anchors.fill: parent
+                anchors.margins: 8
+                radius: width/2
+                color: "#e53935"
+            }
+
+            MouseArea{
+                anchors.fill: parent
+                cursorShape: Qt.PointingHandCursor
+                onClicked: {
+                    cnFilter.capture();
+                }
+            }
+        }
+
         //end of item
     }
 
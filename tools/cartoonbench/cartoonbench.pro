@@ -0,0 +1,37 @@
+# Quality vs time harness for the smoothing scale of the Cartoonifier (see README.md).
+# Build with: qmake && make
+# OpenCV is found through the same INCLUDEPATH/LIBS as the app, adjust them for your install.
+QT += core gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = cartoonbench
+
+DEFINES += CARTOONBENCH_IMAGES=\\\"$$PWD/images\\\"
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../cartoonifier.cpp
+
+HEADERS += \
+    ../../cartoonifier.h
+
+INCLUDEPATH += C:/opencv/build/opencv-4.4.0/install/include
+
+win32 {
+    LIBS += -LC:/opencv/build/opencv-4.4.0/lib
+
+    LIBS +=  -lopencv_core440 \
+             -lopencv_imgproc440 \
+             -lopencv_objdetect440 \
+             -lopencv_imgcodecs440
+}
+
+unix {
+    LIBS += -lopencv_core \
+            -lopencv_imgproc \
+            -lopencv_objdetect \
+            -lopencv_imgcodecs
+}
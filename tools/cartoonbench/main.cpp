@@ -0,0 +1,236 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QVector>
+#include <algorithm>
+
+#include "cartoonifier.h"
+
+// Runs Cartoonifier::cartoonify on fixed images with the smoothing at 1/2 (linear upsampling, the default) and at
+// 1/4 and 1/8 (linear and guided upsampling), times every run and compares the outputs with the 1/2 output.
+//
+//   cartoonbench --mode cartoon --repeat 5 [image ...]
+
+struct BenchConfig {
+    int scale;
+    bool guided;
+};
+
+struct BenchResult {
+    double time = 0;
+    double psnr = 0;
+    double ssim = 0;
+    double edges = 0;
+};
+
+static Mat toMat(const QImage &image)
+{
+    QImage::Format format = image.format() == QImage::Format_Grayscale8 ? QImage::Format_Grayscale8
+                                                                         : QImage::Format_RGB888;
+    QImage converted = image.convertToFormat(format);
+
+    return Mat(converted.height(),
+               converted.width(),
+               format == QImage::Format_Grayscale8 ? CV_8UC1 : CV_8UC3,
+               converted.bits(),
+               converted.bytesPerLine()).clone();
+}
+
+// Mean SSIM over the channels, with the usual 11 x 11 gaussian window (sigma 1.5).
+static double ssim(const Mat &first, const Mat &second)
+{
+    const double C1 = 6.5025, C2 = 58.5225;
+
+    Mat I1, I2;
+    first.convertTo(I1, CV_32F);
+    second.convertTo(I2, CV_32F);
+
+    Mat mu1, mu2;
+    GaussianBlur(I1, mu1, Size(11, 11), 1.5);
+    GaussianBlur(I2, mu2, Size(11, 11), 1.5);
+
+    Mat mu1_2 = mu1.mul(mu1);
+    Mat mu2_2 = mu2.mul(mu2);
+    Mat mu1_mu2 = mu1.mul(mu2);
+
+    Mat sigma1_2, sigma2_2, sigma12;
+    GaussianBlur(I1.mul(I1), sigma1_2, Size(11, 11), 1.5);
+    sigma1_2 -= mu1_2;
+    GaussianBlur(I2.mul(I2), sigma2_2, Size(11, 11), 1.5);
+    sigma2_2 -= mu2_2;
+    GaussianBlur(I1.mul(I2), sigma12, Size(11, 11), 1.5);
+    sigma12 -= mu1_mu2;
+
+    Mat t1 = 2 * mu1_mu2 + C1;
+    Mat t2 = 2 * sigma12 + C2;
+    Mat t3 = t1.mul(t2);
+
+    t1 = mu1_2 + mu2_2 + C1;
+    t2 = sigma1_2 + sigma2_2 + C2;
+    t1 = t1.mul(t2);
+
+    Mat ssimMap;
+    divide(t3, t1, ssimMap);
+
+    Scalar channels = mean(ssimMap);
+    double total = 0;
+
+    for(int i=0; i<first.channels(); i++){
+        total += channels[i];
+    }
+
+    return total / first.channels();
+}
+
+// Mean gradient magnitude of the luma, a measure of how sharp the edges of the output are.
+static double edgeStrength(const Mat &image)
+{
+    Mat gray, dx, dy, magnitude;
+
+    if(image.channels() == 3){
+        cvtColor(image, gray, COLOR_RGB2GRAY);
+    }else {
+        gray = image;
+    }
+
+    Sobel(gray, dx, CV_32F, 1, 0);
+    Sobel(gray, dy, CV_32F, 0, 1);
+    cv::magnitude(dx, dy, magnitude);
+
+    return mean(magnitude)[0];
+}
+
+static QString configName(const BenchConfig &config)
+{
+    return QString("1/%1 %2").arg(config.scale).arg(config.guided ? "guided" : "linear");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Cartoonifier smoothing scale quality vs time harness");
+    parser.addHelpOption();
+    parser.addOption({"mode", "painting, cartoon or scary.", "mode", "cartoon"});
+    parser.addOption({"repeat", "Timed runs per image and setting, the median is reported.", "count", "5"});
+    parser.addPositionalArgument("images", "Images to process, the images next to the harness by default.");
+    parser.process(app);
+
+    Cartoonifier::Mode mode = Cartoonifier::Cartoon;
+
+    if(parser.value("mode") == "painting"){
+        mode = Cartoonifier::Painting;
+    }else if(parser.value("mode") == "scary"){
+        mode = Cartoonifier::ScaryCartoon;
+    }
+
+    int repeat = qMax(1, parser.value("repeat").toInt());
+
+    QStringList paths = parser.positionalArguments();
+
+    if(paths.isEmpty()){
+        QDir dir(CARTOONBENCH_IMAGES);
+
+        for(const QString &name : dir.entryList({"*.png", "*.jpg"}, QDir::Files, QDir::Name)){
+            paths.append(dir.filePath(name));
+        }
+    }
+
+    //the first one is the reference the others are compared with
+    const QVector<BenchConfig> configs = {{2, false}, {4, false}, {4, true}, {8, false}, {8, true}};
+
+    Cartoonifier cartoonifier;
+    QVector<BenchResult> totals(configs.size());
+    int imageCount = 0;
+
+    QTextStream out(stdout);
+    out << "| image | smoothing | time (ms) | PSNR (dB) | SSIM | edge strength |\n"
+        << "|---|---|---|---|---|---|\n";
+
+    for(const QString &path : paths){
+
+        QImage image(path);
+
+        if(image.isNull()){
+            out << "could not load " << path << "\n";
+            continue;
+        }
+
+        //the app feeds the Cartoonifier 8 bit RGB frames
+        Mat frame = toMat(image.convertToFormat(QImage::Format_RGB888));
+        Mat reference;
+        double referenceEdges = 0;
+
+        for(int c=0; c<configs.size(); c++){
+
+            cartoonifier.setSmoothingScale(configs[c].scale);
+            cartoonifier.setGuidedUpsampling(configs[c].guided);
+
+            //a warm up run, so the allocations and the OpenCV thread pool are not timed
+            QImage output = cartoonifier.cartoonify(frame, mode);
+
+            QVector<qint64> times;
+
+            for(int i=0; i<repeat; i++){
+                QElapsedTimer timer;
+                timer.start();
+                output = cartoonifier.cartoonify(frame, mode);
+                times.append(timer.nsecsElapsed());
+            }
+
+            std::sort(times.begin(), times.end());
+
+            Mat result = toMat(output);
+            BenchResult r;
+            r.time = times[times.size() / 2] / 1000000.0;
+
+            if(c == 0){
+                reference = result;
+                referenceEdges = edgeStrength(result);
+                r.psnr = 0;
+                r.ssim = 1;
+                r.edges = 1;
+            }else {
+                r.psnr = PSNR(reference, result);
+                r.ssim = ssim(reference, result);
+                r.edges = edgeStrength(result) / referenceEdges;
+            }
+
+            totals[c].time += r.time;
+            totals[c].psnr += r.psnr;
+            totals[c].ssim += r.ssim;
+            totals[c].edges += r.edges;
+
+            out << "| " << QFileInfo(path).fileName() << " (" << frame.cols << "x" << frame.rows << ")"
+                << " | " << configName(configs[c])
+                << " | " << QString::number(r.time, 'f', 1)
+                << " | " << (c == 0 ? QString("-") : QString::number(r.psnr, 'f', 1))
+                << " | " << QString::number(r.ssim, 'f', 3)
+                << " | " << QString::number(r.edges * 100, 'f', 0) << "% |\n";
+        }
+
+        imageCount++;
+    }
+
+    if(imageCount == 0){
+        return 1;
+    }
+
+    //averages over the images, the edge strength is relative to the 1/2 output
+    out << "\n| smoothing | time (ms) | PSNR (dB) | SSIM | edge strength |\n"
+        << "|---|---|---|---|---|\n";
+
+    for(int c=0; c<configs.size(); c++){
+        out << "| " << configName(configs[c])
+            << " | " << QString::number(totals[c].time / imageCount, 'f', 1)
+            << " | " << (c == 0 ? QString("-") : QString::number(totals[c].psnr / imageCount, 'f', 1))
+            << " | " << QString::number(totals[c].ssim / imageCount, 'f', 3)
+            << " | " << QString::number(totals[c].edges * 100 / imageCount, 'f', 0) << "% |\n";
+    }
+
+    return 0;
+}
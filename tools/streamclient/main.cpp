@@ -0,0 +1,91 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <QTextStream>
+#include <QVector>
+
+#include "streamclient.h"
+
+// Connects N clients to the MJPEG stream of CNFilter for a while and reports the frames per second they received.
+//
+//   streamclient --port 8080 --clients 50 --duration 10 --slow 5 --slow-rate 20000
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("MJPEG stream test client");
+    parser.addHelpOption();
+    parser.addOption({"host", "Host of the stream.", "host", "127.0.0.1"});
+    parser.addOption({"port", "Port of the stream (CNFilter::streamPort).", "port", "8080"});
+    parser.addOption({"clients", "Number of clients.", "count", "1"});
+    parser.addOption({"duration", "Seconds to receive for.", "seconds", "10"});
+    parser.addOption({"slow", "How many of the clients are slow.", "count", "0"});
+    parser.addOption({"slow-rate", "Bytes per second a slow client reads.", "bytes", "20000"});
+    parser.process(app);
+
+    int clientCount = qMax(1, parser.value("clients").toInt());
+    int slowCount = qBound(0, parser.value("slow").toInt(), clientCount);
+    int duration = qMax(1, parser.value("duration").toInt());
+    qint64 slowRate = qMax(1, parser.value("slow-rate").toInt());
+
+    QVector<StreamClient*> clients;
+
+    for(int i=0; i<clientCount; i++){
+        StreamClient *client = new StreamClient(parser.value("host"),
+                                                static_cast<quint16>(parser.value("port").toUInt()),
+                                                i < slowCount ? slowRate : 0,
+                                                &app);
+        clients.append(client);
+        client->start();
+    }
+
+    QTimer::singleShot(duration * 1000, &app, [&](){
+
+        for(StreamClient *client : clients){
+            client->stop();
+        }
+
+        QTextStream out(stdout);
+
+        //fast and slow clients are reported separately, the slow ones show how many frames they skip
+        for(int slow=0; slow<2; slow++){
+
+            double minFps = 0, maxFps = 0, totalFps = 0;
+            qint64 totalBytes = 0;
+            int count = 0;
+
+            for(StreamClient *client : clients){
+
+                if(client->isSlow() != (slow == 1)){
+                    continue;
+                }
+
+                if(!client->errorString().isEmpty() && client->frameCount() == 0){
+                    out << "client error: " << client->errorString() << "\n";
+                }
+
+                double fps = client->framesPerSecond();
+                minFps = count == 0 ? fps : qMin(minFps, fps);
+                maxFps = count == 0 ? fps : qMax(maxFps, fps);
+                totalFps += fps;
+                totalBytes += client->byteCount();
+                count++;
+            }
+
+            if(count == 0){
+                continue;
+            }
+
+            out << (slow ? "slow" : "fast") << " clients: " << count
+                << "  fps min/avg/max: " << QString::number(minFps, 'f', 1)
+                << " / " << QString::number(totalFps / count, 'f', 1)
+                << " / " << QString::number(maxFps, 'f', 1)
+                << "  KiB/s per client: " << QString::number(totalBytes / 1024.0 / duration / count, 'f', 1) << "\n";
+        }
+
+        app.quit();
+    });
+
+    return app.exec();
+}
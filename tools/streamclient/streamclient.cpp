@@ -0,0 +1,117 @@
+#include "streamclient.h"
+
+static const QByteArray BOUNDARY = QByteArrayLiteral("--cnframe\r\n");
+//slow clients read every READ_INTERVAL ms
+static const int READ_INTERVAL = 50;
+
+StreamClient::StreamClient(const QString &host, quint16 port, qint64 maxBytesPerSecond, QObject *parent)
+    : QObject(parent), host(host), port(port), maxBytesPerSecond(maxBytesPerSecond)
+{
+    socket = new QTcpSocket(this);
+    readTimer = new QTimer(this);
+    readTimer->setInterval(READ_INTERVAL);
+
+    connect(socket, &QTcpSocket::connected, this, &StreamClient::onConnected);
+    connect(socket, static_cast<void(QTcpSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error),
+            this, &StreamClient::onError);
+
+    if(isSlow()){
+        //keep the data in the kernel, so that the server sees the backpressure
+        socket->setReadBufferSize(maxBytesPerSecond * READ_INTERVAL / 1000 + 1);
+        connect(readTimer, &QTimer::timeout, this, &StreamClient::onReadyRead);
+    }else {
+        connect(socket, &QTcpSocket::readyRead, this, &StreamClient::onReadyRead);
+    }
+}
+
+void StreamClient::start()
+{
+    socket->connectToHost(host, port);
+}
+
+void StreamClient::stop()
+{
+    if(elapsed.isValid()){
+        elapsedAtStop = elapsed.elapsed();
+    }
+
+    readTimer->stop();
+    socket->abort();
+}
+
+int StreamClient::frameCount() const
+{
+    return frames;
+}
+
+qint64 StreamClient::byteCount() const
+{
+    return bytes;
+}
+
+double StreamClient::framesPerSecond() const
+{
+    if(elapsedAtStop <= 0){
+        return 0;
+    }
+
+    return frames * 1000.0 / elapsedAtStop;
+}
+
+bool StreamClient::isSlow() const
+{
+    return maxBytesPerSecond > 0;
+}
+
+QString StreamClient::errorString() const
+{
+    return error;
+}
+
+void StreamClient::onConnected()
+{
+    socket->write("GET / HTTP/1.0\r\n\r\n");
+    elapsed.start();
+
+    if(isSlow()){
+        readTimer->start();
+    }
+}
+
+void StreamClient::onReadyRead()
+{
+    if(isSlow()){
+        consume(socket->read(maxBytesPerSecond * READ_INTERVAL / 1000 + 1));
+    }else {
+        consume(socket->readAll());
+    }
+}
+
+void StreamClient::onError()
+{
+    if(error.isEmpty()){
+        error = socket->errorString();
+    }
+}
+
+void StreamClient::consume(const QByteArray &data)
+{
+    if(data.isEmpty()){
+        return;
+    }
+
+    bytes += data.size();
+
+    //keep the end of the previous read, a boundary can be split between two reads
+    QByteArray buffer = tail + data;
+    int from = 0;
+    int index;
+
+    while((index = buffer.indexOf(BOUNDARY, from)) >= 0){
+        frames++;
+        from = index + BOUNDARY.size();
+    }
+
+    int keep = qMin(BOUNDARY.size() - 1, buffer.size() - from);
+    tail = buffer.right(keep);
+}
@@ -0,0 +1,49 @@
+#ifndef STREAMCLIENT_H
+#define STREAMCLIENT_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// One connection to the MJPEG stream. The frames are counted from the multipart boundaries in the received data.
+// A slow client only reads maxBytesPerSecond, so the server has to skip frames for it.
+class StreamClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StreamClient(const QString &host, quint16 port, qint64 maxBytesPerSecond = 0, QObject *parent = nullptr);
+
+    void start();
+    void stop();
+
+    int frameCount() const;
+    qint64 byteCount() const;
+    double framesPerSecond() const;
+    bool isSlow() const;
+    QString errorString() const;
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onError();
+
+private:
+    QTcpSocket *socket;
+    QTimer *readTimer;
+    QElapsedTimer elapsed;
+    qint64 elapsedAtStop = 0;
+
+    QString host;
+    quint16 port;
+    qint64 maxBytesPerSecond;
+
+    QByteArray tail;
+    int frames = 0;
+    qint64 bytes = 0;
+    QString error;
+
+    void consume(const QByteArray &data);
+};
+
+#endif // STREAMCLIENT_H
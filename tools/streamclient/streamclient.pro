@@ -0,0 +1,15 @@
+# Local test client for the MJPEG stream of CNFilter (see README.md).
+# Build with: qmake && make
+QT -= gui
+QT += network
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = streamclient
+
+SOURCES += main.cpp \
+    streamclient.cpp
+
+HEADERS += \
+    streamclient.h